@@ -0,0 +1,479 @@
+// -----------------------------------------------------------------------------
+// @file main.c
+//
+// @date April, 2025
+//
+// @author Gino Francesco Bogo
+// -----------------------------------------------------------------------------
+
+#include <stdbool.h> // bool
+#include <stdint.h>  // int32_t, uint8_t, uint32_t, uint64_t
+#include <stdio.h>   // FILE, fprintf, printf, remove
+#include <stdlib.h>  // atoi, free, malloc, qsort
+#include <string.h>  // memcpy, strcmp
+#include <time.h>    // clock_gettime, CLOCK_MONOTONIC
+#include <unistd.h>  // sysconf
+
+#include "g_bmp.h"
+
+// NOTE: usage: g_bmp_bench [--csv | --json] [--warmup N] [--reps N] [--threads N] [--max-mpix N]
+//       The SIMD level follows G_BMP_SIMD, the results go to stdout, one record per operation and size.
+
+#define G_BENCH_TMP_FILE "g_bmp_bench.bmp"
+
+typedef struct g_bench_size_t {
+    int32_t width;
+    int32_t height;
+} g_bench_size_t;
+
+typedef struct g_bench_ctx_t {
+    g_bmp_t         image;   // synthetic source
+    g_bmp_t         scratch; // per-repetition copy for in-place operations
+    g_bmp_t         output;
+    g_feature_map_t feature_map;
+    float          *filter_ptr;
+    int32_t         filter_dim;
+    const char     *filename;
+} g_bench_ctx_t;
+
+typedef struct g_bench_op_t {
+    const char *name;
+    int32_t     filter_dim; // 0 for the operations without a filter
+    bool        separable;
+    bool (*prepare)(g_bench_ctx_t *ctx); // untimed, runs before each repetition
+    bool (*run)(g_bench_ctx_t *ctx);
+} g_bench_op_t;
+
+// -----------------------------------------------------------------------------
+// Operations
+// -----------------------------------------------------------------------------
+
+static bool __copy_image(g_bench_ctx_t *ctx) {
+    const int32_t width  = ctx->image.getWidth(&ctx->image);
+    const int32_t height = ctx->image.getHeight(&ctx->image);
+
+    bool rvalue = ctx->scratch.Create(&ctx->scratch, width, height);
+
+    if (rvalue) {
+        const size_t bytes = (size_t)ctx->image.r.stride * height; // planes with the same stride
+
+        memcpy(ctx->scratch.r.ptr, ctx->image.r.ptr, bytes);
+        memcpy(ctx->scratch.g.ptr, ctx->image.g.ptr, bytes);
+        memcpy(ctx->scratch.b.ptr, ctx->image.b.ptr, bytes);
+    }
+
+    return rvalue;
+}
+
+static bool __save_file(g_bench_ctx_t *ctx) {
+    return ctx->image.Save(&ctx->image, ctx->filename);
+}
+
+static bool __run_load(g_bench_ctx_t *ctx) {
+    return ctx->scratch.Load(&ctx->scratch, ctx->filename);
+}
+
+static bool __run_save(g_bench_ctx_t *ctx) {
+    return ctx->image.Save(&ctx->image, ctx->filename);
+}
+
+static bool __run_grayscale(g_bench_ctx_t *ctx) {
+    return ctx->scratch.toGrayscale(&ctx->scratch);
+}
+
+static bool __run_filter(g_bench_ctx_t *ctx) {
+    return ctx->image.applyFilter(&ctx->image, &ctx->output, ctx->filter_ptr, ctx->filter_dim * ctx->filter_dim);
+}
+
+static bool __run_kernel(g_bench_ctx_t *ctx) {
+    float *weights_ptr[3] = {ctx->filter_ptr, ctx->filter_ptr, ctx->filter_ptr};
+
+    return ctx->image.applyKernel(&ctx->image, &ctx->feature_map, weights_ptr, ctx->filter_dim * ctx->filter_dim);
+}
+
+static bool __run_box_blur(g_bench_ctx_t *ctx) {
+    return ctx->image.applyBoxBlur(&ctx->image, &ctx->output, (ctx->filter_dim - 1) / 2);
+}
+
+static bool __run_gaussian_blur(g_bench_ctx_t *ctx) {
+    return ctx->image.applyGaussianBlur(&ctx->image, &ctx->output, 5.0f);
+}
+
+static bool __run_median(g_bench_ctx_t *ctx) {
+    return ctx->image.applyMedianFilter(&ctx->image, &ctx->output, (ctx->filter_dim - 1) / 2);
+}
+
+static bool __run_morphology(g_bench_ctx_t *ctx) {
+    return ctx->image.applyMorphology(&ctx->image, &ctx->output, G_BMP_MORPH_OPEN, (ctx->filter_dim - 1) / 2, (ctx->filter_dim - 1) / 2);
+}
+
+static bool __run_half_box(g_bench_ctx_t *ctx) {
+    const int32_t width  = (ctx->image.r.width + 1) / 2;
+    const int32_t height = (ctx->image.r.height + 1) / 2;
+
+    return ctx->image.applyResize(&ctx->image, &ctx->output, width, height, G_BMP_RESIZE_HALF_BOX);
+}
+
+static bool __run_half_gaussian(g_bench_ctx_t *ctx) {
+    const int32_t width  = (ctx->image.r.width + 1) / 2;
+    const int32_t height = (ctx->image.r.height + 1) / 2;
+
+    return ctx->image.applyResize(&ctx->image, &ctx->output, width, height, G_BMP_RESIZE_HALF_GAUSSIAN);
+}
+
+// NOTE: down to 2/3, the non-integer factor of 1080p -> 720p
+static bool __run_bilinear(g_bench_ctx_t *ctx) {
+    const int32_t width  = ctx->image.r.width * 2 / 3;
+    const int32_t height = ctx->image.r.height * 2 / 3;
+
+    return ctx->image.applyResize(&ctx->image, &ctx->output, width, height, G_BMP_RESIZE_BILINEAR);
+}
+
+static bool __run_area(g_bench_ctx_t *ctx) {
+    const int32_t width  = ctx->image.r.width * 2 / 3;
+    const int32_t height = ctx->image.r.height * 2 / 3;
+
+    return ctx->image.applyResize(&ctx->image, &ctx->output, width, height, G_BMP_RESIZE_AREA);
+}
+
+static bool __run_stats(g_bench_ctx_t *ctx) {
+    g_bmp_stats_t stats[3];
+
+    return ctx->image.getStats(&ctx->image, stats);
+}
+
+static bool __run_equalize(g_bench_ctx_t *ctx) {
+    return ctx->image.equalizeHistogram(&ctx->image, &ctx->output);
+}
+
+static bool __run_clahe(g_bench_ctx_t *ctx) {
+    return ctx->image.applyClahe(&ctx->image, &ctx->output, 8, 8, 4.0f);
+}
+
+static bool __run_select(g_bench_ctx_t *ctx) {
+    return ctx->image.selectColor(&ctx->image, &ctx->output, (g_rgb_t){254, 254, 183}, (g_hsi_t){0.8f, 0.1f, 0.5f});
+}
+
+static bool __run_select_range(g_bench_ctx_t *ctx) {
+    return ctx->image.selectColorRange(&ctx->image, &ctx->output, (g_rgb_t){200, 120, 0}, (g_rgb_t){255, 255, 120});
+}
+
+// NOTE: toGrayscale, applyFilter and selectColor fused over strips
+static bool __run_pipeline(g_bench_ctx_t *ctx) {
+    const g_bmp_op_t ops[3] = {
+        {.type = G_BMP_OP_GRAYSCALE},
+        {.type = G_BMP_OP_FILTER, .filter_ptr = ctx->filter_ptr, .filter_len = ctx->filter_dim * ctx->filter_dim},
+        {.type = G_BMP_OP_SELECT, .color = {254, 254, 183}, .threshold = {0.8f, 0.1f, 0.5f}},
+    };
+
+    return ctx->image.applyPipeline(&ctx->image, &ctx->output, ops, 3);
+}
+
+// clang-format off
+static const g_bench_op_t __ops[] = {
+    {"Load",              0,  false, __save_file,  __run_load},
+    {"Save",              0,  false, NULL,         __run_save},
+    {"toGrayscale",       0,  false, __copy_image, __run_grayscale},
+    {"applyFilter",       3,  false, NULL,         __run_filter},
+    {"applyFilter",       5,  false, NULL,         __run_filter},
+    {"applyFilter",       7,  false, NULL,         __run_filter},
+    {"applyFilter",       9,  false, NULL,         __run_filter},
+    {"applyFilter",       11, false, NULL,         __run_filter},
+    {"applyFilter",       13, false, NULL,         __run_filter},
+    {"applyFilter",       15, false, NULL,         __run_filter},
+    {"applyFilter",       21, false, NULL,         __run_filter},
+    {"applyFilter",       31, false, NULL,         __run_filter},
+    {"applyFilter",       3,  true,  NULL,         __run_filter},
+    {"applyFilter",       7,  true,  NULL,         __run_filter},
+    {"applyFilter",       15, true,  NULL,         __run_filter},
+    {"applyKernel",       3,  false, NULL,         __run_kernel},
+    {"applyKernel",       7,  false, NULL,         __run_kernel},
+    {"applyKernel",       21, false, NULL,         __run_kernel},
+    {"applyBoxBlur",      3,  true,  NULL,         __run_box_blur},
+    {"applyBoxBlur",      15, true,  NULL,         __run_box_blur},
+    {"applyGaussianBlur", 0,  true,  NULL,         __run_gaussian_blur},
+    {"applyMedianFilter", 3,  false, NULL,         __run_median},
+    {"applyMedianFilter", 5,  false, NULL,         __run_median},
+    {"applyMedianFilter", 15, false, NULL,         __run_median},
+    {"applyMorphology",   3,  false, NULL,         __run_morphology},
+    {"applyMorphology",   15, false, NULL,         __run_morphology},
+    {"resize:box/2",    0,  false, NULL,         __run_half_box},
+    {"resize:gauss/2",  0,  false, NULL,         __run_half_gaussian},
+    {"resize:bilinear", 0,  false, NULL,         __run_bilinear},
+    {"resize:area",     0,  false, NULL,         __run_area},
+    {"getStats",          0,  false, NULL,         __run_stats},
+    {"equalizeHistogram", 0,  false, NULL,         __run_equalize},
+    {"applyClahe",        0,  false, NULL,         __run_clahe},
+    {"selectColor",       0,  false, NULL,         __run_select},
+    {"selectColorRange",  0,  false, NULL,         __run_select_range},
+    {"applyPipeline",     3,  false, NULL,         __run_pipeline},
+};
+
+static const g_bench_size_t __sizes[] = {
+    {64,    64},
+    {256,   256},
+    {640,   480},
+    {1920,  1080},
+    {3840,  2160},  // 4K
+    {7680,  4320},  // 8K
+    {15360, 8640},  // 16K
+};
+// clang-format on
+
+// -----------------------------------------------------------------------------
+// Internal Functions
+// -----------------------------------------------------------------------------
+
+static uint32_t __xorshift(uint32_t *state) {
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return (*state = x);
+}
+
+// NOTE: smooth gradients plus noise, so that the color selections match a realistic share of the pixels
+static void __fill_image(g_bmp_t *image, uint32_t seed) {
+    const int32_t width  = image->getWidth(image);
+    const int32_t height = image->getHeight(image);
+
+    for (int32_t y = 0; y < height; ++y) {
+        const int32_t y_row = y * image->r.stride;
+
+        for (int32_t x = 0; x < width; ++x) {
+            const uint32_t noise = __xorshift(&seed);
+
+            image->r.ptr[y_row + x] = (uint8_t)((x * 255 / width) ^ (noise & 0x0F));
+            image->g.ptr[y_row + x] = (uint8_t)((y * 255 / height) ^ ((noise >> 8) & 0x0F));
+            image->b.ptr[y_row + x] = (uint8_t)(noise >> 16);
+        }
+    }
+}
+
+#define G_BENCH_FFT_MIN_DIM 9 // smallest dense filter of the library's FFT path, with taps that are not integers
+
+// NOTE: the dense filters are made rank > 1 on purpose, so that they run through the 2-D engine. From
+//       G_BENCH_FFT_MIN_DIM their taps are thirds, not integers over a power of two, so that they reach the FFT
+//       instead of the exact integer engine.
+static void __fill_filter(float *filter_ptr, int32_t filter_dim, bool separable) {
+    const int32_t center = filter_dim / 2;
+
+    for (int32_t ky = 0; ky < filter_dim; ++ky) {
+        for (int32_t kx = 0; kx < filter_dim; ++kx) {
+            const float wx = (float)(center + 1 - abs(kx - center));
+            const float wy = (float)(center + 1 - abs(ky - center));
+
+            const float wd = (float)((kx * 7 + ky * 3) % 5) - 2.0f;
+
+            filter_ptr[ky * filter_dim + kx] = separable                              ? (wx * wy)
+                                               : (filter_dim >= G_BENCH_FFT_MIN_DIM) ? (wd / 3.0f)
+                                                                                     : wd;
+        }
+    }
+
+    float sum = 0.0f;
+
+    for (int32_t i = 0; i < filter_dim * filter_dim; ++i) {
+        sum += filter_ptr[i];
+    }
+
+    if (separable && (sum != 0.0f)) {
+        for (int32_t i = 0; i < filter_dim * filter_dim; ++i) {
+            filter_ptr[i] /= sum;
+        }
+    }
+}
+
+static double __now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec * 1e-6;
+}
+
+static int __compare_double(const void *a, const void *b) {
+    const double x = *(const double *)a;
+    const double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+// NOTE: nearest-rank percentile of sorted samples
+static double __percentile(const double *samples, int32_t samples_num, int32_t percent) {
+    int32_t rank = (percent * samples_num + 99) / 100;
+
+    rank = (rank < 1) ? 1 : rank;
+
+    return samples[rank - 1];
+}
+
+// -----------------------------------------------------------------------------
+// Main
+// -----------------------------------------------------------------------------
+
+int main(int argc, char *argv[]) {
+    bool    is_json  = false;
+    int32_t warmup   = 2;
+    int32_t reps     = 15;
+    int32_t threads  = 0; // all online CPUs
+    int32_t max_mpix = 40; // up to 8K by default, 16K needs --max-mpix 140
+
+    for (int32_t i = 1; i < argc; ++i) {
+        const bool has_value = (i + 1 < argc);
+
+        if (strcmp(argv[i], "--json") == 0) {
+            is_json = true;
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            is_json = false;
+        } else if (has_value && (strcmp(argv[i], "--warmup") == 0)) {
+            warmup = atoi(argv[++i]);
+        } else if (has_value && (strcmp(argv[i], "--reps") == 0)) {
+            reps = atoi(argv[++i]);
+        } else if (has_value && (strcmp(argv[i], "--threads") == 0)) {
+            threads = atoi(argv[++i]);
+        } else if (has_value && (strcmp(argv[i], "--max-mpix") == 0)) {
+            max_mpix = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--csv | --json] [--warmup N] [--reps N] [--threads N] [--max-mpix N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    warmup = (warmup < 0) ? 0 : warmup;
+    reps   = (reps < 1) ? 1 : reps;
+
+    g_bmp_set_threads(threads);
+
+    const int32_t threads_num = (threads > 0) ? threads : (int32_t)sysconf(_SC_NPROCESSORS_ONLN);
+
+    static const char *simd_names[] = {"scalar", "sse4.1", "avx2", "avx512"};
+
+    g_bench_ctx_t ctx = {.filename = G_BENCH_TMP_FILE};
+
+    g_bmp_link(&ctx.image);
+    g_bmp_link(&ctx.scratch);
+    g_bmp_link(&ctx.output);
+
+    const char *simd = simd_names[ctx.image.getSimd(&ctx.image)];
+
+    const int32_t ops_num = (int32_t)(sizeof(__ops) / sizeof(__ops[0]));
+
+    int32_t filter_max = 1;
+
+    for (int32_t o = 0; o < ops_num; ++o) {
+        filter_max = (__ops[o].filter_dim > filter_max) ? __ops[o].filter_dim : filter_max;
+    }
+
+    double *samples    = (double *)malloc(reps * sizeof(double));
+    float  *filter_ptr = (float *)malloc((size_t)filter_max * filter_max * sizeof(float));
+
+    if ((samples == NULL) || (filter_ptr == NULL)) {
+        free(samples);
+        free(filter_ptr);
+        return 1;
+    }
+
+    ctx.filter_ptr = filter_ptr;
+
+    if (is_json) {
+        printf("[\n");
+    } else {
+        printf("op,filter,separable,width,height,simd,threads,reps,median_ms,p95_ms,mpix_s\n");
+    }
+
+    bool is_first = true;
+
+    const int32_t sizes_num = (int32_t)(sizeof(__sizes) / sizeof(__sizes[0]));
+
+    for (int32_t s = 0; s < sizes_num; ++s) {
+        const int32_t width  = __sizes[s].width;
+        const int32_t height = __sizes[s].height;
+        const double  mpix   = (double)width * height * 1e-6;
+
+        if (mpix > (double)max_mpix) {
+            continue;
+        }
+
+        if (!ctx.image.Create(&ctx.image, width, height)) {
+            fprintf(stderr, "cannot allocate %dx%d\n", width, height);
+            break;
+        }
+
+        __fill_image(&ctx.image, 0x9E3779B9u ^ (uint32_t)s);
+
+        ctx.feature_map.width  = width;
+        ctx.feature_map.height = height;
+        ctx.feature_map.ptr    = (float *)malloc((size_t)width * height * sizeof(float));
+
+        for (int32_t o = 0; (ctx.feature_map.ptr != NULL) && (o < ops_num); ++o) {
+            const g_bench_op_t *op = &__ops[o];
+
+            ctx.filter_dim = op->filter_dim;
+
+            if (op->filter_dim > 0) {
+                __fill_filter(filter_ptr, op->filter_dim, op->separable);
+            }
+
+            bool rvalue = true;
+
+            for (int32_t r = 0; rvalue && (r < warmup + reps); ++r) {
+                rvalue = rvalue && ((op->prepare == NULL) || op->prepare(&ctx));
+
+                const double t0 = __now_ms();
+
+                rvalue = rvalue && op->run(&ctx);
+
+                const double t1 = __now_ms();
+
+                if (r >= warmup) {
+                    samples[r - warmup] = t1 - t0;
+                }
+            }
+
+            if (!rvalue) {
+                fprintf(stderr, "%s failed on %dx%d\n", op->name, width, height);
+                continue;
+            }
+
+            qsort(samples, reps, sizeof(double), __compare_double);
+
+            const double median = __percentile(samples, reps, 50);
+            const double p95    = __percentile(samples, reps, 95);
+            const double rate   = (median > 0.0) ? mpix / (median * 1e-3) : 0.0;
+
+            if (is_json) {
+                printf("%s  {\"op\": \"%s\", \"filter\": %d, \"separable\": %s, \"width\": %d, \"height\": %d, "
+                       "\"simd\": \"%s\", \"threads\": %d, \"reps\": %d, \"median_ms\": %.4f, \"p95_ms\": %.4f, \"mpix_s\": %.2f}",
+                       is_first ? "" : ",\n", op->name, op->filter_dim, op->separable ? "true" : "false", width, height, //
+                       simd, threads_num, reps, median, p95, rate);
+            } else {
+                printf("%s,%d,%d,%d,%d,%s,%d,%d,%.4f,%.4f,%.2f\n", op->name, op->filter_dim, op->separable ? 1 : 0, //
+                       width, height, simd, threads_num, reps, median, p95, rate);
+            }
+
+            fflush(stdout);
+
+            is_first = false;
+        }
+
+        free(ctx.feature_map.ptr);
+    }
+
+    if (is_json) {
+        printf("\n]\n");
+    }
+
+    (void)remove(G_BENCH_TMP_FILE);
+
+    ctx.image.Destroy(&ctx.image);
+    ctx.scratch.Destroy(&ctx.scratch);
+    ctx.output.Destroy(&ctx.output);
+
+    free(samples);
+    free(filter_ptr);
+
+    return 0;
+}
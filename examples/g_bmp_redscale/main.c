@@ -23,7 +23,7 @@ int main(int argc, char *argv[]) {
         uint32_t height = image.getHeight(&image);
 
         for (uint32_t y = 0; y < height; y++) {
-            const uint32_t y_row = y * width;
+            const uint32_t y_row = y * image.r.stride;
 
             float h = 255 * (y / (float)height);
 
@@ -27,7 +27,7 @@ int main(int argc, char *argv[]) {
         g_random_seed(time(NULL));
 
         for (uint32_t y = 0; y < height; y++) {
-            const uint32_t y_row = y * width;
+            const uint32_t y_row = y * image.r.stride;
 
             for (uint32_t x = 0; x < width; x++) {
                 image.r.ptr[y_row + x] = (uint8_t)(g_random_range(0, 255));
@@ -49,5 +49,20 @@ int main(int argc, char *argv[]) {
 
     image.Destroy(&image);
 
+    // NOTE: the 3 x 3 median removes the impulses that a linear filter would only smear
+    if (image.Load(&image, "g_bmp_salt_and_pepper.bmp")) {
+        g_bmp_t median;
+
+        g_bmp_link(&median);
+
+        if (image.applyMedianFilter(&image, &median, 1)) {
+            median.Save(&median, "g_bmp_salt_and_pepper_median.bmp");
+        }
+
+        median.Destroy(&median);
+    }
+
+    image.Destroy(&image);
+
     return 0;
 }
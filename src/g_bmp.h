@@ -10,7 +10,8 @@
 #define G_BMP_H
 
 #include <stdbool.h> // bool
-#include <stdint.h>  // int32_t, uint8_t, uint16_t, uint32_t
+#include <stddef.h>  // size_t
+#include <stdint.h>  // int32_t, int64_t, uint8_t, uint16_t, uint32_t
 
 // -----------------------------------------------------------------------------
 
@@ -48,17 +49,138 @@ typedef struct __attribute__((packed)) g_dib_header_t {
     uint32_t important_colors; // Important colors (0 = all)
 } g_dib_header_t;
 
+// NOTE: the row `y` starts at `ptr + y * stride`. The planes of an image are padded to 64-byte rows and come from
+//       one 64-byte aligned block, the bytes past `width` are not part of the image.
 typedef struct g_bmp_channel_t {
     uint8_t *ptr;
     int32_t  width;
     int32_t  height;
+    int32_t  stride; // bytes per row, at least `width`
 } g_bmp_channel_t;
 
+// NOTE: the integer types round to the nearest (ties to even) and saturate, the half type rounds to the nearest
+//       half (ties to even) like the F16C instructions
+typedef enum g_feature_type_t {
+    G_FEATURE_F32 = 0, // float
+    G_FEATURE_U8  = 1, // uint8_t
+    G_FEATURE_I16 = 2, // int16_t
+    G_FEATURE_F16 = 3, // IEEE 754 half precision, as uint16_t bits
+} g_feature_type_t;
+
 typedef struct g_feature_map_t {
-    float  *ptr;
+    union {
+        float    *ptr; // G_FEATURE_F32
+        uint8_t  *u8_ptr;
+        int16_t  *i16_ptr;
+        uint16_t *f16_ptr;
+    };
+    int32_t          width;
+    int32_t          height;
+    int32_t          stride; // elements per row (0 = width)
+    g_feature_type_t type;   // G_FEATURE_F32 when zero-initialized
+} g_feature_map_t;
+
+// NOTE: one bit per pixel, LSB first within a byte, rows `stride` bytes apart. The bits past `width` are zero.
+typedef struct g_bmp_mask_t {
+    uint8_t *ptr;
+    int32_t  width;
+    int32_t  height;
+    int32_t  stride; // bytes per row, at least (width + 7) / 8
+} g_bmp_mask_t;
+
+// NOTE: morphology with a rectangular structuring element, the box being clipped to the image
+typedef enum g_bmp_morph_t {
+    G_BMP_MORPH_ERODE  = 0, // min (and) over the box
+    G_BMP_MORPH_DILATE = 1, // max (or) over the box
+    G_BMP_MORPH_OPEN   = 2, // erode, then dilate: removes the specks smaller than the box
+    G_BMP_MORPH_CLOSE  = 3, // dilate, then erode: fills the holes smaller than the box
+} g_bmp_morph_t;
+
+typedef enum g_bmp_resize_t {
+    G_BMP_RESIZE_BILINEAR      = 0, // any size, pixel centers aligned
+    G_BMP_RESIZE_AREA          = 1, // any size, mean of the source area under each pixel (downscaling)
+    G_BMP_RESIZE_HALF_BOX      = 2, // (width + 1) / 2 x (height + 1) / 2, mean of 2 x 2 pixels
+    G_BMP_RESIZE_HALF_GAUSSIAN = 3, // (width + 1) / 2 x (height + 1) / 2, 5 x 5 binomial at the even pixels (pyrDown)
+} g_bmp_resize_t;
+
+typedef struct g_bmp_rect_t {
+    int32_t x;
+    int32_t y;
     int32_t width;
     int32_t height;
-} g_feature_map_t;
+} g_bmp_rect_t;
+
+typedef struct g_bmp_region_t {
+    int64_t      area; // pixels
+    g_bmp_rect_t bounds;
+} g_bmp_region_t;
+
+// NOTE: storage of the planes and of the scratch buffers of the operations. `alloc` must return memory aligned to
+//       `alignment` and, like `free`, may be called from the worker threads at the same time.
+typedef struct g_bmp_allocator_t {
+    void *(*alloc)(void *ctx, size_t size, size_t alignment);
+    void (*free)(void *ctx, void *ptr);
+    void *ctx;
+} g_bmp_allocator_t;
+
+// NOTE: summed-area table of a plane, `sum_ptr[y * (width + 1) + x]` being the sum of the pixels above and on the
+//       left of (x, y). The sums wrap modulo 2^32 (2^64 for the squares), which keeps the sum of any rectangle of
+//       up to 2^24 pixels exact.
+typedef struct g_bmp_integral_t {
+    uint32_t *sum_ptr;   // (width + 1) * (height + 1)
+    uint64_t *sqsum_ptr; // same layout for the squared pixels (optional)
+    int32_t   width;     // of the image
+    int32_t   height;
+} g_bmp_integral_t;
+
+// NOTE: histogram of a plane and the statistics drawn from it, exactly as a pass over the pixels would
+typedef struct g_bmp_stats_t {
+    uint64_t histogram[256];
+    uint8_t  min;
+    uint8_t  max;
+    double   mean;
+    double   stddev; // of the population
+} g_bmp_stats_t;
+
+// NOTE: a bank of `kernels_num` kernels over the three planes, `weights_ptr[((n * 3 + p) * kernel_dim + ky) *
+//       kernel_dim + kx]` being the tap (kx, ky) of the kernel `n` on the plane `p` (0 = R, 1 = G, 2 = B). The
+//       output (x, y) is centered on the pixel (x * stride, y * stride) and its taps are `dilation` pixels apart.
+typedef struct g_bmp_layer_t {
+    const float *weights_ptr; // kernels_num * 3 * kernel_dim * kernel_dim
+    const float *bias_ptr;    // kernels_num (NULL = none)
+    int32_t      kernels_num;
+    int32_t      kernel_dim;  // odd
+    int32_t      stride;      // 1 = every pixel
+    int32_t      dilation;    // 1 = adjacent taps
+    bool         relu;        // max(0, x)
+} g_bmp_layer_t;
+
+typedef enum g_bmp_op_type_t {
+    G_BMP_OP_GRAYSCALE    = 0, // toGrayscale
+    G_BMP_OP_FILTER       = 1, // applyFilter
+    G_BMP_OP_SELECT       = 2, // selectColor
+    G_BMP_OP_SELECT_RANGE = 3, // selectColorRange
+} g_bmp_op_type_t;
+
+// NOTE: a step of applyPipeline, with the arguments of the operation it stands for
+typedef struct g_bmp_op_t {
+    g_bmp_op_type_t type;
+    const float    *filter_ptr; // G_BMP_OP_FILTER
+    int32_t         filter_len;
+    g_rgb_t         color;     // G_BMP_OP_SELECT, first color of G_BMP_OP_SELECT_RANGE
+    g_rgb_t         color_b;   // G_BMP_OP_SELECT_RANGE
+    g_hsi_t         threshold; // G_BMP_OP_SELECT
+} g_bmp_op_t;
+
+typedef enum g_bmp_simd_t {
+    G_BMP_SIMD_SCALAR = 0,
+    G_BMP_SIMD_SSE41  = 1,
+    G_BMP_SIMD_AVX2   = 2,
+    G_BMP_SIMD_AVX512 = 3,
+} g_bmp_simd_t;
+
+struct g_bmp_kernels_t;
+struct g_bmp_pyramid_t;
 
 typedef struct g_bmp_t {
     // variables
@@ -67,35 +189,210 @@ typedef struct g_bmp_t {
     g_bmp_channel_t b;
     g_bmp_header_t  bmp_header;
     g_dib_header_t  dib_header;
+    int32_t         channels; // 3 (RGB) or 1 (grayscale: g and b alias r)
 
     // functions
+    // NOTE: reuses the block of the current planes when it is large enough. Only the operations that map each pixel
+    //       on its own (equalizeHistogram, applyClahe, selectColor and selectColorRange) may run in place, with
+    //       `self` as `output`; the others read neighbours that would already be written and return false for it.
     bool (*Create)(struct g_bmp_t *self, int32_t width, int32_t height);
+    bool (*CreateGrayscale)(struct g_bmp_t *self, int32_t width, int32_t height);
     void (*Destroy)(struct g_bmp_t *self);
 
+    // NOTE: makes `self` a view of the rectangle of `parent` (a view as well, possibly), which shares the planes and
+    //       is valid as long as they are and the image owning them is not moved. Views are accepted as input and
+    //       output of every operation, an output view is written in place, must have the size and the channels of
+    //       the result and must not overlap the input. toGrayscale on a color view writes the luminance to its three
+    //       planes.
+    bool (*CreateView)(struct g_bmp_t *self, struct g_bmp_t *parent, int32_t x, int32_t y, int32_t width, int32_t height);
+
     bool (*Load)(struct g_bmp_t *self, const char *filename);
+    bool (*LoadMapped)(struct g_bmp_t *self, const char *filename); // planes may stay backed by the file mapping
     bool (*Save)(struct g_bmp_t *self, const char *filename);
 
     int32_t (*getWidth)(struct g_bmp_t *self);
     int32_t (*getHeight)(struct g_bmp_t *self);
+    int32_t (*getChannels)(struct g_bmp_t *self);
 
     bool (*toGrayscale)(struct g_bmp_t *self);
 
+    bool (*toGrayscalePlane)(struct g_bmp_t *self, struct g_bmp_channel_t *output); // single plane, allocated by the caller (stride 0 = width)
+
+    // NOTE: non-separable filters and kernels from 9 x 9 run through a tiled FFT, whose rounding moves a result by
+    //       up to ~1e-4 of the sum of |w|. applyKernel keeps it, applyFilter takes the results that close to an
+    //       integer as the integer (e.g. a blur of a flat area), so a pixel is off by 1 only when its exact value
+    //       is that close to an integer without being one (~0.005% of the pixels of a random blur). Filters of
+    //       integer taps over a power of two (e.g. a Laplacian, or a binomial blur / 16) are accumulated exactly in
+    //       int32 at every size instead.
     bool (*applyFilter)(struct g_bmp_t *self, struct g_bmp_t *output, float *filter_ptr, int32_t filter_len);
 
+    bool (*applyFilterSeparable)(struct g_bmp_t *self, struct g_bmp_t *output, float *filter_x_ptr, float *filter_y_ptr, int32_t filter_dim);
+
+    // NOTE: filters the file `input` into the file `output` by strips of `strip_rows` rows (0 = default), so the
+    //       memory is bound by the strip and the filter size instead of the image. The output is the one of Load,
+    //       applyFilter and Save, except that the non-separable filters from 9 x 9 without integer taps run
+    //       without the FFT (as in applyPipeline), so a few pixels may differ by 1 from applyFilter.
+    bool (*applyFilterStream)(struct g_bmp_t *self, const char *input, const char *output, float *filter_ptr, int32_t filter_len, int32_t strip_rows);
+
     bool (*applyKernel)(struct g_bmp_t *self, struct g_feature_map_t *output, float *weights_ptr[3], int32_t weights_len);
 
+    // NOTE: the `layer->kernels_num` feature maps of a layer in one pass, clamped to edge like applyKernel but not
+    //       clamped to [0, 255]. `outputs[n]` is (width + stride - 1) / stride by (height + stride - 1) / stride.
+    bool (*applyLayer)(struct g_bmp_t *self, struct g_feature_map_t *outputs, const struct g_bmp_layer_t *layer);
+
+    // NOTE: mean of the (2 * radius + 1)^2 box with clamp-to-edge, rounded, at a cost independent of the radius
+    //       (0 <= radius <= 1024)
+    bool (*applyBoxBlur)(struct g_bmp_t *self, struct g_bmp_t *output, int32_t radius);
+
+    // NOTE: approximation of a Gaussian blur by three box blurs
+    bool (*applyGaussianBlur)(struct g_bmp_t *self, struct g_bmp_t *output, float sigma);
+
+    // NOTE: median of the (2 * radius + 1)^2 box with clamp-to-edge (0 <= radius <= 127), e.g. radius 1 against
+    //       salt-and-pepper noise. 3 x 3 and 5 x 5 run vectorized sorting networks, the larger boxes column
+    //       histograms at a cost independent of the radius.
+    bool (*applyMedianFilter)(struct g_bmp_t *self, struct g_bmp_t *output, int32_t radius);
+
+    // NOTE: erosion/dilation of every plane by the (2 * radius_x + 1) x (2 * radius_y + 1) box (radii up to 1024),
+    //       with about 3 comparisons per pixel and direction whatever the size (van Herk/Gil-Werman)
+    bool (*applyMorphology)(struct g_bmp_t *self, struct g_bmp_t *output, g_bmp_morph_t op, int32_t radius_x, int32_t radius_y);
+
+    // NOTE: resamples to `width` x `height`, clamped to edge and rounded. The halving modes only compute the kept
+    //       pixels and run vectorized, so they are the fast way down by a factor of 2.
+    bool (*applyResize)(struct g_bmp_t *self, struct g_bmp_t *output, int32_t width, int32_t height, g_bmp_resize_t mode);
+
+    // NOTE: `levels[0]` is a view of `self` (valid as long as its planes are), each next level the halving of the
+    //       previous one by `mode` (G_BMP_RESIZE_HALF_BOX or G_BMP_RESIZE_HALF_GAUSSIAN), all of them in one block.
+    //       Release with g_bmp_pyramid_destroy.
+    bool (*buildPyramid)(struct g_bmp_t *self, struct g_bmp_pyramid_t *output, int32_t levels_num, g_bmp_resize_t mode);
+
+    // NOTE: mean and variance (optional) of the `channel` plane over the (2 * radius + 1)^2 box of each pixel, the
+    //       box being clipped to the image, into maps allocated by the caller
+    bool (*getLocalStats)(struct g_bmp_t *self, int32_t channel, int32_t radius, struct g_feature_map_t *mean, struct g_feature_map_t *variance);
+
+    // NOTE: fills the summed-area table of the `channel` plane (0 = R, 1 = G, 2 = B), see g_bmp_integral_create
+    bool (*getIntegral)(struct g_bmp_t *self, int32_t channel, struct g_bmp_integral_t *output);
+
+    // NOTE: the histogram, min, max, mean and standard deviation of the R, G and B planes in a single pass over the
+    //       pixels, each band of rows counting into sub-histograms of its own (the same three for a grayscale image)
+    bool (*getStats)(struct g_bmp_t *self, struct g_bmp_stats_t stats[3]);
+
+    // NOTE: maps each plane through its cumulative histogram so its levels spread over [0, 255], as a vectorized
+    //       table lookup (`output` may be `self`)
+    bool (*equalizeHistogram)(struct g_bmp_t *self, struct g_bmp_t *output);
+
+    // NOTE: contrast limited adaptive equalization (CLAHE) of each plane over a `tiles_x` x `tiles_y` grid (up to
+    //       64 x 64). The histogram of a tile is clipped at `clip_limit` (0 < clip_limit <= 256) times its mean bin
+    //       count before the equalization, and every pixel interpolates the mappings of the 4 nearest tiles
+    //       (`output` may be `self`).
+    bool (*applyClahe)(struct g_bmp_t *self, struct g_bmp_t *output, int32_t tiles_x, int32_t tiles_y, float clip_limit);
+
     bool (*selectColor)(struct g_bmp_t *self, struct g_bmp_t *output, g_rgb_t color, g_hsi_t threshold);
 
     bool (*selectColorRange)(struct g_bmp_t *self, struct g_bmp_t *output, g_rgb_t color_a, g_rgb_t color_b);
 
+    // NOTE: the mask variants of the selections, `output` is allocated by the caller (see g_bmp_mask_create)
+    bool (*selectColorMask)(struct g_bmp_t *self, struct g_bmp_mask_t *output, g_rgb_t color, g_hsi_t threshold);
+
+    bool (*selectColorRangeMask)(struct g_bmp_t *self, struct g_bmp_mask_t *output, g_rgb_t color_a, g_rgb_t color_b);
+
+    // NOTE: runs the `ops_num` steps of `ops_ptr` (up to 16) on strips of rows sized for the cache, the intermediate
+    //       images never leave the scratch of the workers: `self` is read and `output` (not `self`) written once.
+    //       The result is the one of the chained operations, except that the non-separable filters from 9 x 9
+    //       without integer taps run without the FFT (as applyFilterStream does).
+    bool (*applyPipeline)(struct g_bmp_t *self, struct g_bmp_t *output, const struct g_bmp_op_t *ops_ptr, int32_t ops_num);
+
+    // NOTE: keeps the H/S/I planes computed by the first selection for the next ones. They are dropped when the
+    //       pixels change through the API, through this image or through any view sharing its planes; disable and
+    //       enable again after writing the planes directly.
+    void (*setHsiCache)(struct g_bmp_t *self, bool enabled);
+
+    g_bmp_simd_t (*getSimd)(struct g_bmp_t *self);
+
+    void (*setThreads)(struct g_bmp_t *self, int32_t threads); // 0 = process default
+
+    // NOTE: releases the planes, then takes the storage from `allocator` (NULL = heap)
+    void (*setAllocator)(struct g_bmp_t *self, const struct g_bmp_allocator_t *allocator);
+
     // intrinsic
-    bool _is_safe;
+    bool                          _is_safe;
+    bool                          _is_view; // planes borrowed from another image (CreateView)
+    int32_t                       _threads; // worker threads used by the operations (0 = process default)
+    const struct g_bmp_kernels_t *_kernels; // hot loops installed by g_bmp_link
+    g_bmp_allocator_t             _allocator; // storage of the planes and of the scratch buffers (setAllocator)
+    size_t                        _capacity;  // bytes of the block holding the planes
+    void                         *_map_ptr; // file mapping backing the planes (LoadMapped)
+    size_t                        _map_size;
+    bool                          _hsi_cache; // keep the H/S/I planes between selections (setHsiCache)
+    float                        *_hsi_ptr;   // H, S and I planes of the pixels, NULL until computed
+    struct g_bmp_t               *_owner;     // image owning the planes of a view (CreateView), NULL otherwise
+    uint64_t                      _generation;     // changes of the pixels through the API, counted on the owner
+    uint64_t                      _hsi_generation; // `_generation` of the owner when the H/S/I planes were computed
 } g_bmp_t;
 
+#define G_BMP_PYRAMID_LEVELS 16
+
+typedef struct g_bmp_pyramid_t {
+    g_bmp_t levels[G_BMP_PYRAMID_LEVELS]; // views, from the full size down
+    int32_t levels_num;
+
+    // intrinsic
+    void             *_block_ptr; // planes of the levels from 1
+    g_bmp_allocator_t _allocator;
+} g_bmp_pyramid_t;
+
 // -----------------------------------------------------------------------------
 
 extern void g_bmp_link(g_bmp_t *self);
 
+// NOTE: links with the kernels of a given level (clamped to the CPU support), G_BMP_SIMD does the same for g_bmp_link
+extern void g_bmp_link_simd(g_bmp_t *self, g_bmp_simd_t simd);
+
+// NOTE: sets the process default of worker threads (0 = all online CPUs); results do not depend on it
+extern void g_bmp_set_threads(int32_t threads);
+
+// NOTE: allocates a zeroed mask with a stride of whole 64-bit words
+extern bool g_bmp_mask_create(g_bmp_mask_t *mask, int32_t width, int32_t height);
+
+extern void g_bmp_mask_destroy(g_bmp_mask_t *mask);
+
+// NOTE: number of pixels set (-1 on invalid mask)
+extern int64_t g_bmp_mask_area(const g_bmp_mask_t *mask);
+
+// NOTE: smallest rectangle holding the pixels set, false when there are none
+extern bool g_bmp_mask_bounds(const g_bmp_mask_t *mask, g_bmp_rect_t *bounds);
+
+// NOTE: labels the connected components (`connectivity` 4 or 8) in raster order of their first pixel, from 1 (0 =
+//       background). `labels_ptr` (width * height) and `regions_ptr` (the first `regions_max` components, index
+//       = label - 1) are optional. Returns the number of components, -1 on failure.
+extern int32_t g_bmp_mask_label(const g_bmp_mask_t *mask,        //
+                                int32_t             connectivity, //
+                                int32_t            *labels_ptr,   //
+                                g_bmp_region_t     *regions_ptr,  //
+                                int32_t             regions_max);
+
+// NOTE: applyMorphology on the bits of a mask, 64 pixels per word operation. `output` is allocated by the caller
+//       with the size of `mask` and must not be `mask`.
+extern bool g_bmp_mask_morphology(const g_bmp_mask_t *mask, g_bmp_mask_t *output, g_bmp_morph_t op, int32_t radius_x, int32_t radius_y);
+
+extern void g_bmp_pyramid_destroy(g_bmp_pyramid_t *pyramid);
+
+// NOTE: allocates a zeroed map of `type` elements (stride = width)
+extern bool g_feature_map_create(g_feature_map_t *map, int32_t width, int32_t height, g_feature_type_t type);
+
+extern void g_feature_map_destroy(g_feature_map_t *map);
+
+// NOTE: the row `y` of the map converted to floats, `width` of them
+extern bool g_feature_map_read(const g_feature_map_t *map, int32_t y, float *dst_ptr);
+
+// NOTE: allocates the tables of a `width` x `height` image, the squares only `with_squares`
+extern bool g_bmp_integral_create(g_bmp_integral_t *integral, int32_t width, int32_t height, bool with_squares);
+
+extern void g_bmp_integral_destroy(g_bmp_integral_t *integral);
+
+// NOTE: mean and variance (optional, needs the squares) of the pixels of `rect` clipped to the image, false when
+//       the clipped rectangle is empty
+extern bool g_bmp_integral_stats(const g_bmp_integral_t *integral, g_bmp_rect_t rect, double *mean, double *variance);
+
 #endif // G_BMP_H
 
 // -----------------------------------------------------------------------------